@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/wait.h>
 
 #define SECS_PER_TEST   1
 #define NUM_TESTS       3
@@ -92,6 +93,129 @@ benchmark_decode(void)
     return best;
 }
 
+/* Scan a buffer of log-like text for every embedded ULID. Returns the
+ * best throughput in bytes per second.
+ */
+static long
+benchmark_scan(void)
+{
+    struct ulid_generator g[1];
+    ulid_generator_init(g, ULID_RELAXED);
+
+    /* Fill a buffer with lines of text, each containing one ULID */
+    static char buf[1L << 24];
+    long len = 0;
+    while (len + 128 < (long)sizeof(buf)) {
+        char ulid[27];
+        ulid_generate(g, ulid);
+        len += sprintf(buf + len,
+                "2016-07-30T23:54:10.259Z INFO request_id=%s "
+                "GET /api/v1/users/%d 200 (%d ms)\n",
+                ulid, rand() % 100000, rand() % 1000);
+    }
+
+    long best = 0;
+    for (int i = 0; i < NUM_TESTS; i++) {
+        unsigned long long start = platform_utime(0);
+        long off = 0;
+        for (;;) {
+            uint64_t bin[2];
+            long r = ulid_scan((unsigned char *)bin, buf + off, len - off);
+            if (r < 0)
+                break;
+            benchmark_sum += bin[0] + bin[1];
+            off += r + 26;
+        }
+        double dt = (platform_utime(0) - start) / 1000000.0;
+        long result = len / dt;
+        if (result > best)
+            best = result;
+    }
+
+    return best;
+}
+
+static volatile sig_atomic_t lease_done;
+
+static void
+lease_alarm_handler(int signum)
+{
+    (void)signum;
+    lease_done = 1;
+}
+
+/* Lease n ULIDs at a time from a ulid_lease_daemon() process over a
+ * temporary socket, draining each lease. With k > 1, k leases are
+ * requested per call with ulid_lease_request_n(). Returns the best
+ * number of leases per second and stores the matching ULIDs per second.
+ */
+static long
+benchmark_lease(unsigned long n, int k, long *ulids)
+{
+    char path[64];
+    sprintf(path, "/tmp/ulid-benchmark-%ld.sock", (long)getpid());
+    pid_t pid = fork();
+    if (pid == -1)
+        return 0;
+    if (!pid) {
+        struct ulid_generator g[1];
+        ulid_generator_init(g, 0);
+        ulid_lease_daemon(g, path);
+        _exit(1);
+    }
+
+    /* Wait for the daemon to start listening */
+    int fd = -1;
+    for (int i = 0; fd == -1 && i < 1000; i++) {
+        fd = ulid_lease_connect(path);
+        if (fd == -1) {
+            struct timespec ms = {0, 1000000};
+            nanosleep(&ms, 0);
+        }
+    }
+    if (fd == -1) {
+        kill(pid, SIGTERM);
+        waitpid(pid, 0, 0);
+        unlink(path);
+        return 0;
+    }
+
+    long best = 0;
+    *ulids = 0;
+    for (int i = 0; i < NUM_TESTS; i++) {
+        unsigned long leases = 0;
+        unsigned long count = 0;
+        unsigned long long start = platform_utime(0);
+        lease_done = 0;
+        signal(SIGALRM, lease_alarm_handler);
+        alarm(SECS_PER_TEST);
+        while (!lease_done) {
+            struct ulid_lease lease[64];
+            unsigned long counts[64];
+            for (int j = 0; j < k; j++)
+                counts[j] = n;
+            if (k > 1 ? ulid_lease_request_n(fd, lease, counts, k)
+                      : ulid_lease_request(fd, lease, n))
+                break;
+            leases += k;
+            for (int j = 0; j < k; j++)
+                while (!ulid_lease_generate(lease + j, benchmark_ulid))
+                    count++;
+        }
+        double dt = (platform_utime(0) - start) / 1000000.0;
+        if (leases / dt > best) {
+            best = leases / dt;
+            *ulids = count / dt;
+        }
+    }
+
+    close(fd);
+    kill(pid, SIGTERM);
+    waitpid(pid, 0, 0);
+    unlink(path);
+    return best;
+}
+
 int
 main(void)
 {
@@ -108,6 +232,13 @@ main(void)
         sink += benchmark_sum >> 32;
     }
 
+    {
+        printf("ulid_scan()                %8ld MB / s\n",
+                benchmark_scan() / 1000000);
+        sink += benchmark_sum;
+        sink += benchmark_sum >> 32;
+    }
+
     {
         struct ulid_generator g[1];
         ulid_generator_init(g, 0);
@@ -127,4 +258,29 @@ main(void)
         for (int i = 0; i < 27; i++)
             sink += benchmark_ulid[i];
     }
+
+    {
+        struct ulid_generator g[1];
+        ulid_generator_init(g, ULID_RELAXED | ULID_KERNEL);
+        printf("ulid_generate() [kernel]   %8ld kULID / s\n",
+                benchmark_generate(g) / 1000);
+        sink += g->last[15];
+        for (int i = 0; i < 27; i++)
+            sink += benchmark_ulid[i];
+        ulid_generator_free(g);
+    }
+
+    {
+        long ulids;
+        long leases = benchmark_lease(1, 1, &ulids);
+        printf("ulid_lease_request() [1]   %8ld kLease / s (%.2f us)\n",
+                leases / 1000, leases ? 1e6 / leases : 0.0);
+        leases = benchmark_lease(1, 64, &ulids);
+        printf("ulid_lease_request_n() [64]%8ld kLease / s (%.2f us)\n",
+                leases / 1000, leases ? 1e6 / leases : 0.0);
+        leases = benchmark_lease(1024, 1, &ulids);
+        printf("ulid_lease_request() [1024]%8ld kULID / s\n", ulids / 1000);
+        for (int i = 0; i < 27; i++)
+            sink += benchmark_ulid[i];
+    }
 }
@@ -0,0 +1,93 @@
+#include <cstdio>
+#include <cstring>
+#include <unordered_set>
+#include "../ulid.hpp"
+
+#define TEST(x, s) \
+    do { \
+        if (x) { \
+            std::printf("\033[32;1mPASS\033[0m %s\n", s); \
+            count_pass++; \
+        } else { \
+            std::printf("\033[31;1mFAIL\033[0m %s\n", s); \
+            count_fail++; \
+        } \
+    } while (0)
+
+using namespace ulid_literals;
+
+/* Checked entirely at compile time. */
+constexpr ulid min = "00000000000000000000000000"_ulid;
+constexpr ulid max = "7ZZZZZZZZZZZZZZZZZZZZZZZZZ"_ulid;
+constexpr ulid alt = "1IiLl0Ooabcdefghijklmnopqr"_ulid;
+static_assert(min < max, "constexpr compare");
+static_assert(max.high() == ~0ULL && max.low() == ~0ULL, "constexpr decode");
+static_assert(alt.bytes[0] == 0x21 && alt.bytes[15] == 0xf8,
+              "constexpr alternate decode");
+static_assert("01ARZ3NDEKTSV4RRFFQ69G5FAV"_ulid.timestamp() == 1469922850259,
+              "constexpr timestamp");
+
+constexpr bool
+roundtrip(const char *s)
+{
+    char buf[27] = {0};
+    ulid::parse(s).encode(buf);
+    for (int i = 0; i < 27; i++)
+        if (buf[i] != s[i])
+            return false;
+    return true;
+}
+static_assert(roundtrip("01ARZ3NDEKTSV4RRFFQ69G5FAV"), "constexpr encode");
+
+int
+main()
+{
+    int count_pass = 0;
+    int count_fail = 0;
+
+    {
+        ulid u{};
+        TEST(!u.decode("80000000000000000000000000"), "reject too large");
+        TEST(!u.decode("0000000000000000000000000U"), "reject invalid");
+        bool thrown = false;
+        try {
+            ulid::parse("8ZZZZZZZZZZZZZZZZZZZZZZZZZ");
+        } catch (const std::invalid_argument &) {
+            thrown = true;
+        }
+        TEST(thrown, "parse throws");
+    }
+
+    {
+        const unsigned char expect[] = {
+            0x01, 0x23, 0x45, 0x56, 0x67, 0x89, 0xab, 0xcd,
+            0xef, 0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32
+        };
+        ulid a, b{};
+        std::memcpy(a.bytes, expect, sizeof(expect));
+        char text[27];
+        a.encode(text);
+        TEST(b.decode(text) && a == b, "there and back again");
+        TEST(a.str() == text, "str");
+    }
+
+    {
+        ulid ids[3] = {min, alt, max};
+        char text[3][27];
+        ulid back[3];
+        ulid_encode_n(text, ids, 3);
+        TEST(ulid_decode_n(back, text, 3) == 3 &&
+             back[0] == min && back[1] == alt && back[2] == max,
+             "batch encode/decode");
+        text[1][0] = 'U';
+        TEST(ulid_decode_n(back, text, 3) == 1, "batch decode stops");
+    }
+
+    {
+        std::unordered_set<ulid> set = {min, alt, max, alt};
+        TEST(set.size() == 3 && set.count(alt), "hash");
+    }
+
+    std::printf("%d fail, %d pass\n", count_fail, count_pass);
+    return count_fail != 0;
+}
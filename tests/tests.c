@@ -1,3 +1,10 @@
+#ifndef _WIN32
+#  define _POSIX_C_SOURCE 200112L
+#  include <signal.h>
+#  include <time.h>
+#  include <unistd.h>
+#  include <sys/wait.h>
+#endif
 #include <stdio.h>
 #include <string.h>
 #include "../ulid.h"
@@ -13,6 +20,50 @@
         } \
     } while (0)
 
+#ifndef _WIN32
+/* Run a lease daemon in a child process on a temporary socket, and
+ * connect to it. With starve, the daemon's ULID_KERNEL generator has no
+ * entropy. Returns the connected socket, or -1 on error.
+ */
+static int
+daemon_start(char path[64], pid_t *pid, int starve)
+{
+    sprintf(path, "/tmp/ulid-tests-%ld.sock", (long)getpid());
+    *pid = fork();
+    if (*pid == -1)
+        return -1;
+    if (!*pid) {
+        struct ulid_generator g[1];
+        ulid_generator_init(g, starve ? ULID_KERNEL : 0);
+        if (starve)
+            ulid_generator_free(g);
+        ulid_lease_daemon(g, path);
+        _exit(1);
+    }
+    int fd = -1;
+    for (int i = 0; fd == -1 && i < 1000; i++) {
+        fd = ulid_lease_connect(path);
+        if (fd == -1) {
+            struct timespec ms = {0, 1000000};
+            nanosleep(&ms, 0);
+        }
+    }
+    return fd;
+}
+
+static void
+daemon_stop(const char *path, pid_t pid, int fd)
+{
+    if (fd != -1)
+        close(fd);
+    if (pid > 0) {
+        kill(pid, SIGTERM);
+        waitpid(pid, 0, 0);
+    }
+    unlink(path);
+}
+#endif
+
 int
 main(void)
 {
@@ -65,6 +116,194 @@ main(void)
         TEST(!memcmp(bin, expect, sizeof(bin)), "there and back again");
     }
 
+    {
+        const char text[] =
+            "x 01ARZ3NDEKTSV4RRFFQ69G5FAVx 01ARZ3NDEKTSV4RRFFQ69G5FA "
+            "01ARZ3NDEKTSV4RRFFQ69G5FAVV 81ARZ3NDEKTSV4RRFFQ69G5FAV "
+            "01ARZ3NDEKTSV4RRFFQ69G5FAU [01arz3ndektsv4rrffq69g5fav]";
+        unsigned char expect[16];
+        unsigned char bin[16];
+        ulid_decode(expect, "01ARZ3NDEKTSV4RRFFQ69G5FAV");
+        long len = sizeof(text) - 1;
+        long r = ulid_scan(bin, text, len);
+        TEST(r == len - 27, "scan (offset)");
+        TEST(!memcmp(bin, expect, sizeof(bin)), "scan (check)");
+        TEST(ulid_scan(bin, text, len - 27) == -1, "scan (word boundaries)");
+        TEST(ulid_scan(bin, text + len - 27, 26) == 0, "scan (buffer ends)");
+    }
+
+    {
+        struct ulid_generator g[2];
+        ulid_generator_seed(g + 0, 0, "seed", 4);
+        ulid_generator_seed(g + 1, 0, "seed", 4);
+        char a[27], b[27];
+        int same = 1;
+        for (int i = 0; i < 1000; i++) {
+            ulid_generate_at(g + 0, a, 1469922850259 + i / 10);
+            ulid_generate_at(g + 1, b, 1469922850259 + i / 10);
+            same &= !strcmp(a, b);
+        }
+        TEST(same, "seeded generators agree");
+        TEST(!strncmp(a, "01ARZ3NDHP", 10), "generate at timestamp");
+    }
+
+    {
+        /* Merge three runs, one of which is empty. */
+        unsigned char a[3][16] = {{0}}, b[2][16] = {{0}};
+        a[0][15] = 1; a[1][15] = 4; a[2][15] = 5;
+        b[0][15] = 2; b[1][15] = 4;
+        const unsigned char *runs[] = {a[0], b[0], 0};
+        long lens[] = {3, 2, 0};
+        int tree[3];
+        unsigned char out[8][16];
+        long n = 0;
+        for (long r; (r = ulid_merge(out[n], 8 - n, runs, lens, 3, tree));)
+            n += r;
+        int sorted = n == 5;
+        for (long i = 1; i < n; i++)
+            sorted &= memcmp(out[i - 1], out[i], 16) <= 0;
+        sorted &= !ulid_merge(out[0], 8, 0, 0, 0, 0);
+        TEST(sorted && out[4][15] == 5, "merge");
+    }
+
+    {
+        struct ulid_generator g[1];
+        struct ulid_lease lease;
+        ulid_generator_init(g, 0);
+        ulid_generator_lease(g, &lease, 1000);
+        int pass = 1;
+        char prev[27] = "", ulid[27];
+        for (int i = 0; i < 1000; i++) {
+            pass &= !ulid_lease_generate(&lease, ulid);
+            pass &= strcmp(prev, ulid) < 0;
+            strcpy(prev, ulid);
+        }
+        pass &= ulid_lease_generate(&lease, ulid) != 0;
+        ulid_generate(g, ulid);
+        pass &= strcmp(prev, ulid) < 0;
+        TEST(pass, "lease");
+    }
+
+#ifndef _WIN32
+    {
+        /* Pipelined requests, more than one batch's worth. */
+        char path[64];
+        pid_t pid;
+        int fd = daemon_start(path, &pid, 0);
+        struct ulid_lease leases[100];
+        unsigned long counts[100];
+        for (int i = 0; i < 100; i++)
+            counts[i] = i + 1;
+        int pass = fd != -1 && !ulid_lease_request_n(fd, leases, counts, 100);
+        for (int i = 0; pass && i < 100; i++) {
+            pass &= leases[i].count == counts[i];
+            if (i)
+                pass &= ulid_compare(leases[i - 1].next, leases[i].next) < 0;
+        }
+        daemon_stop(path, pid, fd);
+        TEST(pass, "lease daemon");
+    }
+
+    {
+        /* A daemon without entropy must not hand out ULIDs. */
+        char path[64];
+        pid_t pid;
+        int fd = daemon_start(path, &pid, 1);
+        struct ulid_lease leases[2];
+        unsigned long counts[2] = {1, 1000};
+        int pass = fd != -1 && !ulid_lease_request(fd, leases, 10);
+        pass &= leases[0].count == 0;
+        pass &= !ulid_lease_request_n(fd, leases, counts, 2);
+        pass &= leases[0].count == 0 && leases[1].count == 0;
+        daemon_stop(path, pid, fd);
+        TEST(pass, "lease daemon without entropy");
+    }
+#endif
+
+    {
+        unsigned char a[16], b[16], r[16];
+        memset(a, 0xff, 16);
+        memset(b, 0x00, 16);
+        b[15] = 1;
+        TEST(ulid_add(r, a, b) && !memcmp(r, (unsigned char[16]){0}, 16),
+             "add carry");
+        a[0] = 0x01;
+        memset(a + 1, 0, 15);
+        TEST(!ulid_sub(r, a, b) && r[0] == 0 && r[1] == 0xff && r[15] == 0xff,
+             "subtract borrow");
+        ulid_distance(r, b, a);
+        TEST(!ulid_compare(r, (unsigned char[16]){
+                 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}),
+             "distance");
+        TEST(ulid_compare(a, b) > 0 && ulid_compare(b, a) < 0, "compare");
+    }
+
+    {
+        unsigned char lo[16], hi[16], bounds[8][16];
+        ulid_min(lo, 1469922850259);
+        ulid_max(hi, 1469922850266);
+        ulid_split(bounds, lo, hi, 7);
+        int pass = !memcmp(bounds[0], lo, 16) && !memcmp(bounds[7], hi, 16);
+        unsigned char size[16], next[16];
+        ulid_sub(size, bounds[1], bounds[0]);
+        for (int i = 1; i < 7; i++) {
+            ulid_sub(next, bounds[i + 1], bounds[i]);
+            ulid_sub(next, next, size);
+            pass &= ulid_compare(next, (unsigned char[16]){[15] = 1}) <= 0;
+        }
+        TEST(pass, "split");
+
+        ulid_split_time(bounds, lo, hi, 7);
+        pass = !memcmp(bounds[0], lo, 16) && !memcmp(bounds[7], hi, 16);
+        for (int i = 1; i < 7; i++) {
+            unsigned char min[16];
+            ulid_min(min, 1469922850259 + i);
+            pass &= !memcmp(bounds[i], min, 16);
+        }
+        TEST(pass, "split time");
+    }
+
+    {
+        struct ulid_generator g[1];
+        int pass = !ulid_generator_init(g, ULID_RELAXED | ULID_KERNEL);
+        char a[27], b[27] = "";
+        unsigned char bin[16];
+        for (int i = 0; i < 10000; i++) {
+            ulid_generate(g, a);
+            pass &= !ulid_decode(bin, a) && strcmp(a + 10, b + 10);
+            strcpy(b, a);
+        }
+        pass &= !ulid_generator_refill(g);
+        ulid_generator_free(g);
+        TEST(pass, "kernel entropy");
+    }
+
+#ifndef _WIN32
+    {
+        /* A child must not reuse the parent's buffered kernel entropy. */
+        struct ulid_generator g[1];
+        int pass = !ulid_generator_init(g, ULID_RELAXED | ULID_KERNEL);
+        int fds[2];
+        pass &= !pipe(fds);
+        pid_t pid = fork();
+        if (!pid) {
+            char a[27];
+            ulid_generate(g, a);
+            _exit(write(fds[1], a, 26) != 26);
+        }
+        char a[27] = "", b[27];
+        int status;
+        pass &= pid != -1 && read(fds[0], a, 26) == 26;
+        pass &= waitpid(pid, &status, 0) == pid && status == 0;
+        pass &= !ulid_generate(g, b) && strcmp(a + 10, b + 10) != 0;
+        close(fds[0]);
+        close(fds[1]);
+        ulid_generator_free(g);
+        TEST(pass, "kernel entropy fork");
+    }
+#endif
+
     {
         /* Generate a million ULIDs and make sure they're all ordered. */
         struct ulid_generator g[1];
@@ -1,6 +1,11 @@
 #ifdef __MINGW32__
 #  define __USE_MINGW_ANSI_STDIO 1
 #endif
+#ifdef _WIN32
+#  include <io.h>
+#  include <fcntl.h>
+#endif
+#include <ctype.h>
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
@@ -10,20 +15,50 @@
 static void
 usage(FILE *f)
 {
-    fprintf(f, "usage: ulidgen -G [-prs] [-n N]\n");
+    fprintf(f, "usage: ulidgen -G [-eprs] [-n N] [-f PATH]\n");
     fprintf(f, "       ulidgen -C [-iq] <ULIDs...>\n");
     fprintf(f, "       ulidgen -T [-i] <ULIDs...>\n");
+    fprintf(f, "       ulidgen -E [-t] [-o A:B] [files...]\n");
+    fprintf(f, "       ulidgen -F [-iq] [-a TIME] [-b TIME] <ULIDs...>\n");
+    fprintf(f, "       ulidgen -W [-pr] [-n N] [-a TIME] [-d DIST] [-k SEED] "
+               "[-l RATE] [-m PCT]\n");
+    fprintf(f, "       ulidgen -M [-ux] <files...>\n");
+    fprintf(f, "       ulidgen -D [-eprs] -f PATH\n");
+    fprintf(f, "       ulidgen -P [-t] [-n N] [-a TIME] [-b TIME] [LO HI]\n");
     fprintf(f, "       ulidgen -h\n");
     fprintf(f, "  -G      Generate ULIDs\n");
     fprintf(f, "  -C      Check/validate ULIDs\n");
     fprintf(f, "  -T      Print timestamp from ULIDs\n");
+    fprintf(f, "  -E      Extract ULIDs embedded in text\n");
+    fprintf(f, "  -F      Filter ULIDs by timestamp\n");
+    fprintf(f, "  -W      Generate a reproducible synthetic workload\n");
+    fprintf(f, "  -M      Merge files of sorted ULIDs\n");
+    fprintf(f, "  -D      Serve ULID leases on a Unix socket\n");
+    fprintf(f, "  -P      Partition the half-open range [LO, HI) into sub-ranges\n");
     fprintf(f, "  -h      Display this help message\n");
-    fprintf(f, "  -i      (-C|-T) Read ULIDs on standard input\n");
-    fprintf(f, "  -n N    (-G) Number of ULIDs to generate [1]\n");
-    fprintf(f, "  -p      (-G) Only use 79 random bits to avoid overflow\n");
-    fprintf(f, "  -q      (-C) Don't print invalid ULIDs\n");
-    fprintf(f, "  -r      (-G) Non-monotonic ULIDs within timestamp\n");
-    fprintf(f, "  -s      (-G) Require secure initialization\n");
+    fprintf(f, "  -a TIME (-F) Keep ULIDs at or after TIME (sec[.ms])\n");
+    fprintf(f, "          (-W) Start time [1577836800]\n");
+    fprintf(f, "          (-P) Start range at TIME instead of LO\n");
+    fprintf(f, "  -b TIME (-F) Keep ULIDs before TIME (sec[.ms])\n");
+    fprintf(f, "          (-P) End range at TIME instead of HI\n");
+    fprintf(f, "  -d DIST (-W) Distribution: steady, burst, zipf [steady]\n");
+    fprintf(f, "  -e      (-G|-D) Random bits straight from kernel entropy\n");
+    fprintf(f, "  -f PATH (-G|-D) Lease ULIDs over Unix socket PATH\n");
+    fprintf(f, "  -i      (-C|-T|-F) Read ULIDs on standard input\n");
+    fprintf(f, "  -k SEED (-W) Random seed [0]\n");
+    fprintf(f, "  -l RATE (-W) Mean ULIDs per millisecond [1]\n");
+    fprintf(f, "  -m PCT  (-W) Percent of milliseconds with relaxed ULIDs [0]\n");
+    fprintf(f, "  -n N    (-G|-W) Number of ULIDs to generate [1]\n");
+    fprintf(f, "          (-P) Number of sub-ranges [1]\n");
+    fprintf(f, "  -o A:B  (-E) Only ULIDs starting at byte offsets [A, B)\n");
+    fprintf(f, "  -p      (-G|-W|-D) Only use 79 random bits to avoid overflow\n");
+    fprintf(f, "  -q      (-C|-F) Don't print invalid ULIDs\n");
+    fprintf(f, "  -r      (-G|-W|-D) Non-monotonic ULIDs within timestamp\n");
+    fprintf(f, "  -s      (-G|-D) Require secure initialization\n");
+    fprintf(f, "  -t      (-E) Also print each ULID's timestamp\n");
+    fprintf(f, "          (-P) Align sub-ranges to milliseconds\n");
+    fprintf(f, "  -u      (-M) Drop duplicate ULIDs\n");
+    fprintf(f, "  -x      (-M) Read and write raw 16-byte binary ULIDs\n");
 }
 
 static int
@@ -36,19 +71,505 @@ validate(unsigned char buf[16], char *s)
     return 0;
 }
 
+static unsigned long long
+ts_get(const unsigned char buf[16])
+{
+    return (unsigned long long)buf[0] << 40 |
+           (unsigned long long)buf[1] << 32 |
+           (unsigned long long)buf[2] << 24 |
+           (unsigned long long)buf[3] << 16 |
+           (unsigned long long)buf[4] <<  8 |
+           (unsigned long long)buf[5] <<  0;
+}
+
 static void
 ts_print(const unsigned char buf[16])
 {
-    unsigned long long ts =
-        (unsigned long long)buf[0] << 40 |
-        (unsigned long long)buf[1] << 32 |
-        (unsigned long long)buf[2] << 24 |
-        (unsigned long long)buf[3] << 16 |
-        (unsigned long long)buf[4] <<  8 |
-        (unsigned long long)buf[5] <<  0;
+    unsigned long long ts = ts_get(buf);
     printf("%llu.%03llu\n", ts / 1000, ts % 1000);
 }
 
+static int
+is_word(int c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+/* Print every ULID embedded in the text of a stream that starts at a
+ * byte offset in [lo, hi), or to the end of the stream if hi < 0.
+ * Ranges needn't fall on word boundaries: a word straddling lo belongs
+ * to the previous range, and one straddling hi to this range, so
+ * adjacent ranges can be scanned independently, e.g. in parallel.
+ * Returns non-zero on a read error.
+ */
+static int
+extract(FILE *f, int timestamps, long lo, long hi)
+{
+    static char buf[1L << 20];
+    long pos = 0;  /* stream offset of buf[0] */
+
+    if (lo > 0) {
+        /* Seek to the byte before the range, reading up to it if the
+         * stream isn't seekable, then skip any word it's part of.
+         */
+        if (!fseek(f, lo - 1, SEEK_SET)) {
+            pos = lo - 1;
+        } else {
+            for (; pos < lo - 1; pos++)
+                if (getc(f) == EOF)
+                    return ferror(f);
+        }
+        int c;
+        do
+            pos++;
+        while ((c = getc(f)) != EOF && is_word(c));
+        if (c == EOF)
+            return ferror(f);
+    }
+
+    /* Every word starting before hi either ends within 27 bytes of hi,
+     * or is too long to be a ULID, so there's no need to read further.
+     */
+    long limit = hi < 0 ? -1 : hi + 27;
+    long len = 0;
+    for (;;) {
+        long want = sizeof(buf) - len;
+        if (limit >= 0 && want > limit - pos - len)
+            want = limit - pos - len > 0 ? limit - pos - len : 0;
+        long n = fread(buf + len, 1, want, f);
+        int eof = n < want || (limit >= 0 && pos + len + n >= limit);
+        len += n;
+
+        /* Don't scan a word cut off by the end of the block. */
+        long cut = len;
+        if (!eof)
+            while (cut > 0 && is_word(buf[cut - 1]))
+                cut--;
+
+        unsigned char bin[16];
+        for (long off = 0, r; (r = ulid_scan(bin, buf + off, cut - off)) >= 0;) {
+            if (hi >= 0 && pos + off + r >= hi)
+                return ferror(f);
+            char ulid[27];
+            ulid_encode(ulid, bin);
+            if (timestamps) {
+                unsigned long long ts = ts_get(bin);
+                printf("%s %llu.%03llu\n", ulid, ts / 1000, ts % 1000);
+            } else {
+                puts(ulid);
+            }
+            off += r + 26;
+        }
+        if (eof)
+            return ferror(f);
+
+        /* Carry the partial word into the next block. A word already
+         * too long to be a ULID only needs to stay too long.
+         */
+        long tail = len - cut;
+        if (tail > 27) {
+            cut = len - 27;
+            tail = 27;
+        }
+        memmove(buf, buf + cut, tail);
+        pos += cut;
+        len = tail;
+    }
+}
+
+/* Parse a "sec[.ms]" timestamp into unix epoch milliseconds.
+ * Returns non-zero if the timestamp is invalid or out of range.
+ */
+static int
+ts_parse(unsigned long long *ts, const char *s)
+{
+    char *end;
+    if (!isdigit((unsigned char)*s))
+        return 1;
+    errno = 0;
+    unsigned long long sec = strtoull(s, &end, 10);
+    if (errno || sec > (1ULL << 48) / 1000)
+        return 1;
+    unsigned long long ms = 0;
+    if (*end == '.') {
+        int i = 0;
+        for (end++; i < 3 && isdigit((unsigned char)end[i]); i++)
+            ms = ms * 10 + end[i] - '0';
+        if (!i)
+            return 1;
+        for (end += i; i < 3; i++)
+            ms *= 10;
+    }
+    if (*end)
+        return 1;
+    *ts = sec * 1000 + ms;
+    return *ts > 1ULL << 48;
+}
+
+/* Encode the 10-character timestamp prefix for a millisecond time.
+ * The prefix for 2^48, one past the largest timestamp, sorts after
+ * every valid prefix.
+ */
+static void
+ts_prefix(char prefix[10], unsigned long long ts)
+{
+    if (ts >= 1ULL << 48) {
+        memcpy(prefix, "8000000000", 10);
+        return;
+    }
+    unsigned char buf[16] = {0};
+    char ulid[27];
+    for (int i = 0; i < 6; i++)
+        buf[i] = ts >> (40 - i * 8);
+    ulid_encode(ulid, buf);
+    memcpy(prefix, ulid, 10);
+}
+
+/* Canonical Base32 character for each input byte, or zero if invalid. */
+static char canon[256];
+
+static void
+canon_init(void)
+{
+    static const char set[] = "0123456789ABCDEFGHJKMNPQRSTVWXYZ";
+    for (int i = 0; set[i]; i++) {
+        canon[(unsigned char)set[i]] = set[i];
+        canon[tolower((unsigned char)set[i])] = set[i];
+    }
+    canon['O'] = canon['o'] = '0';
+    canon['I'] = canon['i'] = canon['L'] = canon['l'] = '1';
+}
+
+/* Check if a ULID's timestamp falls in the range [lo, hi) by comparing
+ * its canonicalized prefix, without decoding the whole ULID. Every
+ * character is still checked against the Base32 alphabet.
+ * Returns 1 if in range, 0 if not, or -1 if the ULID is invalid.
+ */
+static int
+in_range(const char *s, long len, const char lo[10], const char hi[10])
+{
+    while (len > 0 && (s[len - 1] == '\n' || s[len - 1] == '\r'))
+        len--;
+    if (len != 26)
+        return -1;
+    char text[26];
+    for (int i = 0; i < 26; i++)
+        if (!(text[i] = canon[(unsigned char)s[i]]))
+            return -1;
+    if (text[0] > '7')
+        return -1;
+    return memcmp(text, lo, 10) >= 0 && memcmp(text, hi, 10) < 0;
+}
+
+/* Copy the lines of a stream with in-range ULIDs to standard output.
+ * Returns 1 if any line was invalid, 2 on a read error.
+ */
+static int
+filter(FILE *f, const char lo[10], const char hi[10], int quiet)
+{
+    static char buf[1L << 20];
+    long len = 0;
+    int skip = 0;
+    int result = 0;
+    for (;;) {
+        long want = sizeof(buf) - len;
+        long n = fread(buf + len, 1, want, f);
+        int eof = n < want;
+        len += n;
+
+        char *p = buf;
+        char *end = buf + len;
+        while (p < end) {
+            char *nl = memchr(p, '\n', end - p);
+            if (!nl && !eof && p > buf)
+                break;  /* carry the partial line into the next block */
+            char *next = nl ? nl + 1 : end;
+            if (skip) {
+                /* Remainder of an overlong line, already reported. */
+                skip = !nl;
+                p = next;
+                continue;
+            }
+            switch (in_range(p, next - p, lo, hi)) {
+                case 1: {
+                    fwrite(p, next - p, 1, stdout);
+                    if (!nl)
+                        putchar('\n');
+                } break;
+                case -1: {
+                    int n = next - p > 32 ? 32 : next - p;
+                    while (n > 0 && (p[n - 1] == '\n' || p[n - 1] == '\r'))
+                        n--;
+                    if (!quiet)
+                        fprintf(stderr, "ulidgen: invalid ULID -- %.*s\n",
+                                n, p);
+                    result = 1;
+                    skip = !nl && !eof;
+                } break;
+            }
+            p = next;
+        }
+        if (eof)
+            return ferror(f) ? 2 : result;
+        len = end - p;
+        memmove(buf, p, len);
+    }
+}
+
+/* Timestamp distributions for synthetic workloads */
+enum dist {
+    DIST_STEADY,  /* the same rate every millisecond */
+    DIST_BURST,   /* occasional bursts separated by idle milliseconds */
+    DIST_ZIPF     /* Zipf-distributed hot milliseconds within each second */
+};
+
+#define BURST_LENGTH 16
+#define ZIPF_WINDOW  1000
+
+/* Workload shaping PRNG (splitmix64). */
+static unsigned long long
+rng_next(unsigned long long *s)
+{
+    unsigned long long z = *s += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Returns a uniform double in [0, 1). */
+static double
+rng_uniform(unsigned long long *s)
+{
+    return (rng_next(s) >> 11) / 9007199254740992.0;
+}
+
+/* Write a deterministic stream of synthetic ULIDs to standard output.
+ * Timestamps advance one millisecond at a time from the start time, and
+ * each millisecond is assigned a number of ULIDs according to the
+ * distribution. Each millisecond is generated either as a monotonic run
+ * or as relaxed ULIDs. Everything derives from the seed, so only the
+ * flags that shape the random field are honored (e.g. not ULID_KERNEL).
+ */
+static void
+workload(long count, int flags, unsigned long long ts, enum dist dist,
+         unsigned long long seed, double rate, int relaxed)
+{
+    unsigned long long rng = seed;
+    flags &= ULID_PARANOID | ULID_RELAXED;
+
+    /* One generator for monotonic runs, another for relaxed ULIDs. */
+    struct ulid_generator g[2];
+    for (int i = 0; i < 2; i++) {
+        unsigned char key[9];
+        for (int b = 0; b < 8; b++)
+            key[b] = seed >> (56 - b * 8);
+        key[8] = i;
+        ulid_generator_seed(g + i, flags | (i ? ULID_RELAXED : 0),
+                            key, sizeof(key));
+    }
+
+    /* Expected ULIDs for each rank of millisecond within a window. */
+    static double zipf[ZIPF_WINDOW];
+    if (dist == DIST_ZIPF) {
+        double h = 0;
+        for (int k = 1; k <= ZIPF_WINDOW; k++)
+            h += 1.0 / k;
+        for (int k = 1; k <= ZIPF_WINDOW; k++)
+            zipf[k - 1] = rate * ZIPF_WINDOW / (h * k);
+    }
+
+    for (long tick = 0; count > 0; tick++, ts++) {
+        double expect = 0;
+        switch (dist) {
+            case DIST_STEADY: {
+                expect = rate;
+            } break;
+            case DIST_BURST: {
+                if (rng_uniform(&rng) < 1.0 / BURST_LENGTH)
+                    expect = rate * BURST_LENGTH;
+            } break;
+            case DIST_ZIPF: {
+                int k = tick % ZIPF_WINDOW;
+                if (!k) {
+                    /* Shuffle which milliseconds are hot. */
+                    for (int i = ZIPF_WINDOW - 1; i > 0; i--) {
+                        int j = rng_next(&rng) % (i + 1);
+                        double tmp = zipf[i];
+                        zipf[i] = zipf[j];
+                        zipf[j] = tmp;
+                    }
+                }
+                expect = zipf[k];
+            } break;
+        }
+
+        /* Dither fractional rates so that the mean is exact. */
+        long n = expect + rng_uniform(&rng);
+        int pick = rng_next(&rng) % 100 < (unsigned long long)relaxed;
+        struct ulid_generator *gen = g + pick;
+        for (; n > 0 && count > 0; n--, count--) {
+            char ulid[27];
+            ulid_generate_at(gen, ulid, ts);
+            ulid[26] = '\n';
+            fwrite(ulid, sizeof(ulid), 1, stdout);
+        }
+    }
+}
+
+#define MERGE_BLOCK 4096  /* ULIDs per buffered block */
+
+struct merge_input {
+    FILE *f;
+    const char *name;
+    unsigned char last[16];  /* previous ULID read, to check order */
+    int have_last;
+    unsigned char buf[MERGE_BLOCK * 16];
+};
+
+/* Read the next block of ULIDs from a merge input.
+ * Exits the program on invalid, truncated, or unsorted input, or on
+ * read errors.
+ */
+static long
+merge_read(struct merge_input *in, int binary)
+{
+    long n = 0;
+    if (binary) {
+        long len = fread(in->buf, 1, sizeof(in->buf), in->f);
+        if (len % 16 && !ferror(in->f)) {
+            fprintf(stderr, "ulidgen: truncated ULID in %s\n", in->name);
+            exit(EXIT_FAILURE);
+        }
+        n = len / 16;
+    } else {
+        char line[29] = {0};
+        while (n < MERGE_BLOCK && fgets(line, sizeof(line), in->f)) {
+            if (validate(in->buf + n * 16, line)) {
+                fprintf(stderr, "ulidgen: invalid ULID in %s -- %.26s\n",
+                        in->name, line);
+                exit(EXIT_FAILURE);
+            }
+            n++;
+        }
+    }
+    if (ferror(in->f)) {
+        fprintf(stderr, "ulidgen: input error -- %s\n", in->name);
+        exit(EXIT_FAILURE);
+    }
+
+    for (long i = 0; i < n; i++) {
+        unsigned char *p = in->buf + i * 16;
+        if (in->have_last && memcmp(p, in->last, 16) < 0) {
+            char ulid[27];
+            ulid_encode(ulid, p);
+            fprintf(stderr, "ulidgen: unsorted input in %s -- %s\n",
+                    in->name, ulid);
+            exit(EXIT_FAILURE);
+        }
+        memcpy(in->last, p, 16);
+        in->have_last = 1;
+    }
+    return n;
+}
+
+/* Merge files of sorted ULIDs to standard output.
+ * Memory use is a fixed block per input, regardless of input size.
+ */
+static void
+merge(char **names, int k, int binary, int unique)
+{
+    struct merge_input *in = malloc(sizeof(*in) * k);
+    const unsigned char **runs = malloc(sizeof(*runs) * k);
+    long *lens = malloc(sizeof(*lens) * k);
+    int *tree = malloc(sizeof(*tree) * k);
+    if (!in || !runs || !lens || !tree) {
+        fprintf(stderr, "ulidgen: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < k; i++) {
+        in[i].name = names[i];
+        in[i].have_last = 0;
+        in[i].f = fopen(names[i], binary ? "rb" : "r");
+        if (!in[i].f) {
+            fprintf(stderr, "ulidgen: %s -- %s\n", strerror(errno), names[i]);
+            exit(EXIT_FAILURE);
+        }
+        lens[i] = 0;
+    }
+
+    static unsigned char out[MERGE_BLOCK * 16];
+    unsigned char last[16];
+    int have_last = 0;
+    for (;;) {
+        for (int i = 0; i < k; i++) {
+            if (!lens[i] && in[i].f) {
+                runs[i] = in[i].buf;
+                lens[i] = merge_read(in + i, binary);
+                if (!lens[i]) {
+                    fclose(in[i].f);
+                    in[i].f = 0;
+                }
+            }
+        }
+
+        long n = ulid_merge(out, MERGE_BLOCK, runs, lens, k, tree);
+        if (!n)
+            break;
+        for (long i = 0; i < n; i++) {
+            unsigned char *p = out + i * 16;
+            if (unique) {
+                if (have_last && !memcmp(p, last, 16))
+                    continue;
+                memcpy(last, p, 16);
+                have_last = 1;
+            }
+            if (binary) {
+                fwrite(p, 16, 1, stdout);
+            } else {
+                char ulid[27];
+                ulid_encode(ulid, p);
+                ulid[26] = '\n';
+                fwrite(ulid, sizeof(ulid), 1, stdout);
+            }
+        }
+    }
+
+    free(tree);
+    free(lens);
+    free(runs);
+    free(in);
+}
+
+#ifndef _WIN32
+#define LEASE_SIZE 1024  /* ULIDs per lease requested by -G */
+
+/* Print ULIDs leased from a daemon.
+ */
+static void
+lease_generate(const char *path, long count)
+{
+    int fd = ulid_lease_connect(path);
+    if (fd == -1) {
+        fprintf(stderr, "ulidgen: could not connect -- %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    while (count > 0) {
+        struct ulid_lease lease;
+        unsigned long n = count < LEASE_SIZE ? count : LEASE_SIZE;
+        if (ulid_lease_request(fd, &lease, n) || lease.count != n) {
+            fprintf(stderr, "ulidgen: lease request failed\n");
+            exit(EXIT_FAILURE);
+        }
+        char ulid[27];
+        while (!ulid_lease_generate(&lease, ulid)) {
+            puts(ulid);
+            count--;
+        }
+    }
+}
+#endif
+
 int
 main(int argc, char *argv[])
 {
@@ -56,7 +577,13 @@ main(int argc, char *argv[])
         MODE_NONE,
         MODE_GENERATE,
         MODE_CHECK,
-        MODE_TIMESTAMP
+        MODE_TIMESTAMP,
+        MODE_EXTRACT,
+        MODE_FILTER,
+        MODE_WORKLOAD,
+        MODE_MERGE,
+        MODE_DAEMON,
+        MODE_PARTITION
     } mode = MODE_NONE;
     enum {
         SOURCE_ARGV,
@@ -64,20 +591,85 @@ main(int argc, char *argv[])
     } source = SOURCE_ARGV;
     int flags = 0;
     int quiet = 0;
+    int timestamps = 0;
     long count = 1;
+    unsigned long long after = 0;
+    int after_set = 0;
+    unsigned long long before = 1ULL << 48;
+    enum dist dist = DIST_STEADY;
+    unsigned long long seed = 0;
+    double rate = 1.0;
+    int relaxed = 0;
+    int unique = 0;
+    int before_set = 0;
+    int binary = 0;
+    const char *path = 0;
+    long range_lo = 0;
+    long range_hi = -1;
 
     int option;
-    while ((option = getopt(argc, argv, "CGThipn:qrs")) != -1) {
+    while ((option = getopt(argc, argv, "CDEFGMPTWa:b:d:ef:hik:l:m:o:pn:qrstux")) != -1) {
         switch (option) {
             case 'C': {
                 mode = MODE_CHECK;
             } break;
+            case 'D': {
+                mode = MODE_DAEMON;
+            } break;
+            case 'E': {
+                mode = MODE_EXTRACT;
+            } break;
+            case 'F': {
+                mode = MODE_FILTER;
+            } break;
             case 'G': {
                 mode = MODE_GENERATE;
             } break;
+            case 'M': {
+                mode = MODE_MERGE;
+            } break;
+            case 'P': {
+                mode = MODE_PARTITION;
+            } break;
             case 'T': {
                 mode = MODE_TIMESTAMP;
             } break;
+            case 'W': {
+                mode = MODE_WORKLOAD;
+            } break;
+            case 'a': {
+                if (ts_parse(&after, optarg)) {
+                    fprintf(stderr, "ulidgen: invalid time -- %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                after_set = 1;
+            } break;
+            case 'b': {
+                if (ts_parse(&before, optarg)) {
+                    fprintf(stderr, "ulidgen: invalid time -- %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                before_set = 1;
+            } break;
+            case 'd': {
+                if (!strcmp(optarg, "steady")) {
+                    dist = DIST_STEADY;
+                } else if (!strcmp(optarg, "burst")) {
+                    dist = DIST_BURST;
+                } else if (!strcmp(optarg, "zipf")) {
+                    dist = DIST_ZIPF;
+                } else {
+                    fprintf(stderr, "ulidgen: invalid distribution -- %s\n",
+                            optarg);
+                    exit(EXIT_FAILURE);
+                }
+            } break;
+            case 'e': {
+                flags |= ULID_KERNEL;
+            } break;
+            case 'f': {
+                path = optarg;
+            } break;
             case 'h': {
                 usage(stdout);
                 exit(EXIT_SUCCESS);
@@ -85,6 +677,35 @@ main(int argc, char *argv[])
             case 'i': {
                 source = SOURCE_STDIN;
             } break;
+            case 'k': {
+                char *endptr;
+                errno = 0;
+                seed = strtoull(optarg, &endptr, 0);
+                if (errno || *endptr || !*optarg) {
+                    fprintf(stderr, "ulidgen: invalid seed -- %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+            } break;
+            case 'l': {
+                char *endptr;
+                errno = 0;
+                rate = strtod(optarg, &endptr);
+                if (errno || *endptr || !(rate > 0)) {
+                    fprintf(stderr, "ulidgen: invalid rate -- %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+            } break;
+            case 'm': {
+                char *endptr;
+                errno = 0;
+                long pct = strtol(optarg, &endptr, 10);
+                if (errno || *endptr || pct < 0 || pct > 100) {
+                    fprintf(stderr, "ulidgen: invalid percent -- %s\n",
+                            optarg);
+                    exit(EXIT_FAILURE);
+                }
+                relaxed = pct;
+            } break;
             case 'n': {
                 char *endptr;
                 errno = 0;
@@ -94,6 +715,24 @@ main(int argc, char *argv[])
                     exit(EXIT_FAILURE);
                 }
             } break;
+            case 'o': {
+                char *endptr;
+                errno = 0;
+                range_lo = strtol(optarg, &endptr, 10);
+                if (*endptr == ':' && endptr[1]) {
+                    char *arg = endptr + 1;
+                    range_hi = strtol(arg, &endptr, 10);
+                    if (range_hi < range_lo)
+                        errno = ERANGE;
+                } else if (*endptr == ':') {
+                    endptr++;
+                }
+                if (errno || *endptr || range_lo < 0 || !isdigit((unsigned char)*optarg)) {
+                    fprintf(stderr, "ulidgen: invalid range -- %s\n",
+                            optarg);
+                    exit(EXIT_FAILURE);
+                }
+            } break;
             case 'p': {
                 flags |= ULID_PARANOID;
             } break;
@@ -106,6 +745,15 @@ main(int argc, char *argv[])
             case 's': {
                 flags |= ULID_SECURE;
             } break;
+            case 't': {
+                timestamps = 1;
+            } break;
+            case 'u': {
+                unique = 1;
+            } break;
+            case 'x': {
+                binary = 1;
+            } break;
             default: {
                 usage(stderr);
                 exit(EXIT_FAILURE);
@@ -146,6 +794,15 @@ main(int argc, char *argv[])
         } break;
 
         case MODE_GENERATE: {
+            if (path) {
+#ifdef _WIN32
+                fprintf(stderr, "ulidgen: leases are not supported\n");
+                exit(EXIT_FAILURE);
+#else
+                lease_generate(path, count);
+                break;
+#endif
+            }
             struct ulid_generator ulidgen[1];
             int r = ulid_generator_init(ulidgen, flags);
             if (r != 0 && (flags & ULID_SECURE)) {
@@ -154,9 +811,100 @@ main(int argc, char *argv[])
             }
             while (count--) {
                 char ulid[27];
-                ulid_generate(ulidgen, ulid);
+                if (ulid_generate(ulidgen, ulid)) {
+                    fprintf(stderr, "ulidgen: failed to get kernel entropy\n");
+                    exit(EXIT_FAILURE);
+                }
                 puts(ulid);
             }
+            ulid_generator_free(ulidgen);
+        } break;
+
+        case MODE_DAEMON: {
+#ifdef _WIN32
+            fprintf(stderr, "ulidgen: leases are not supported\n");
+            exit(EXIT_FAILURE);
+#else
+            if (!path) {
+                usage(stderr);
+                exit(EXIT_FAILURE);
+            }
+            struct ulid_generator ulidgen[1];
+            int r = ulid_generator_init(ulidgen, flags);
+            if (r != 0 && (flags & ULID_SECURE)) {
+                fprintf(stderr, "ulidgen: failed to get secure entropy\n");
+                exit(EXIT_FAILURE);
+            }
+            ulid_lease_daemon(ulidgen, path);
+            fprintf(stderr, "ulidgen: could not serve leases -- %s\n", path);
+            exit(EXIT_FAILURE);
+#endif
+        } break;
+
+        case MODE_PARTITION: {
+            /* The range is half-open, [LO, HI), and is given either as
+             * ULIDs on the command line or as times via -a and -b. It
+             * defaults to every ULID except the very largest, which is
+             * HI itself.
+             */
+            unsigned char lo[16] = {0};
+            unsigned char hi[16];
+            ulid_max(hi, (1ULL << 48) - 1);
+            if (argv[optind]) {
+                if (!argv[optind + 1] || argv[optind + 2]) {
+                    usage(stderr);
+                    exit(EXIT_FAILURE);
+                }
+                for (int i = 0; i < 2; i++) {
+                    if (validate(i ? hi : lo, argv[optind + i])) {
+                        fprintf(stderr, "ulidgen: invalid ULID -- %s\n",
+                                argv[optind + i]);
+                        exit(EXIT_FAILURE);
+                    }
+                }
+            }
+            if (after_set)
+                ulid_min(lo, after);
+            if (before_set && before < 1ULL << 48)
+                ulid_min(hi, before);
+            if (ulid_compare(lo, hi) > 0 || count < 1 || count > 1L << 20) {
+                fprintf(stderr, "ulidgen: invalid range\n");
+                exit(EXIT_FAILURE);
+            }
+
+            unsigned char (*bounds)[16] = malloc(16 * (count + 1));
+            if (!bounds) {
+                fprintf(stderr, "ulidgen: out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+            if (timestamps)
+                ulid_split_time(bounds, lo, hi, count);
+            else
+                ulid_split(bounds, lo, hi, count);
+            for (long i = 0; i < count; i++) {
+                char a[27], b[27];
+                ulid_encode(a, bounds[i]);
+                ulid_encode(b, bounds[i + 1]);
+                printf("%s %s\n", a, b);
+            }
+            free(bounds);
+        } break;
+
+        case MODE_WORKLOAD: {
+            unsigned long long start = after_set ? after : 1577836800000ULL;
+            workload(count, flags, start, dist, seed, rate, relaxed);
+        } break;
+
+        case MODE_MERGE: {
+            if (!argv[optind]) {
+                usage(stderr);
+                exit(EXIT_FAILURE);
+            }
+#ifdef _WIN32
+            if (binary)
+                _setmode(_fileno(stdout), _O_BINARY);
+#endif
+            merge(argv + optind, argc - optind, binary, unique);
         } break;
 
         case MODE_TIMESTAMP: {
@@ -180,6 +928,70 @@ main(int argc, char *argv[])
                 } break;
             }
         } break;
+
+        case MODE_EXTRACT: {
+            if (!argv[optind] &&
+                    extract(stdin, timestamps, range_lo, range_hi)) {
+                fprintf(stderr, "ulidgen: input error\n");
+                exit(EXIT_FAILURE);
+            }
+            for (int i = optind; argv[i]; i++) {
+                FILE *f = fopen(argv[i], "rb");
+                if (!f) {
+                    fprintf(stderr, "ulidgen: %s -- %s\n",
+                            strerror(errno), argv[i]);
+                    exit(EXIT_FAILURE);
+                }
+                int err = extract(f, timestamps, range_lo, range_hi);
+                fclose(f);
+                if (err) {
+                    fprintf(stderr, "ulidgen: input error -- %s\n", argv[i]);
+                    exit(EXIT_FAILURE);
+                }
+            }
+        } break;
+
+        case MODE_FILTER: {
+            int result = EXIT_SUCCESS;
+            char lo[10], hi[10];
+            ts_prefix(lo, after);
+            ts_prefix(hi, before);
+            canon_init();
+            switch (source) {
+                case SOURCE_ARGV: {
+                    for (int i = optind; argv[i]; i++) {
+                        switch (in_range(argv[i], strlen(argv[i]), lo, hi)) {
+                            case 1: {
+                                puts(argv[i]);
+                            } break;
+                            case -1: {
+                                if (!quiet)
+                                    fprintf(stderr,
+                                            "ulidgen: invalid ULID -- %s\n",
+                                            argv[i]);
+                                result = EXIT_FAILURE;
+                            } break;
+                        }
+                    }
+                } break;
+                case SOURCE_STDIN: {
+                    switch (filter(stdin, lo, hi, quiet)) {
+                        case 1: {
+                            result = EXIT_FAILURE;
+                        } break;
+                        case 2: {
+                            fprintf(stderr, "ulidgen: input error\n");
+                            exit(EXIT_FAILURE);
+                        } break;
+                    }
+                } break;
+            }
+            if (fflush(stdout) || ferror(stdout)) {
+                fprintf(stderr, "ulidgen: output error\n");
+                exit(EXIT_FAILURE);
+            }
+            exit(result);
+        } break;
     }
 
     if (fflush(stdout) || ferror(stdout)) {
@@ -8,15 +8,30 @@
 #  pragma comment(lib, "advapi32.lib")
 #elif __linux__
 #  define _GNU_SOURCE
+#  include <fcntl.h>
+#  include <poll.h>
 #  include <unistd.h>
+#  include <sys/mman.h>
 #  include <sys/time.h>
+#  include <sys/socket.h>
+#  include <sys/stat.h>
 #  include <sys/syscall.h>
+#  include <sys/un.h>
 #else
-#  define _POSIX_C_SOURCE 200112L
+#  define _POSIX_C_SOURCE 200809L
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <pthread.h>
+#  include <unistd.h>
 #  include <sys/time.h>
+#  include <sys/socket.h>
+#  include <sys/stat.h>
+#  include <sys/un.h>
 #endif
 #include <time.h>
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "ulid.h"
 
@@ -57,7 +72,20 @@ platform_entropy(void *buf, int len)
     BOOLEAN NTAPI SystemFunction036(PVOID, ULONG);
     return !SystemFunction036(buf, len);
 #elif __linux__
-    return syscall(SYS_getrandom, buf, len, 0) != len;
+    /* getrandom() only promises complete reads of up to 256 bytes, and
+     * larger reads may be interrupted by a signal.
+     */
+    char *p = buf;
+    while (len > 0) {
+        long r = syscall(SYS_getrandom, p, len, 0);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return 1;
+        p += r;
+        len -= r;
+    }
+    return 0;
 #else
     int r = 0;
     FILE *f = fopen("/dev/urandom", "rb");
@@ -69,14 +97,140 @@ platform_entropy(void *buf, int len)
 #endif
 }
 
-int
-ulid_generator_init(struct ulid_generator *g, int flags)
+#define POOL_SIZE 4000  /* bytes of buffered kernel entropy */
+
+/* Buffered kernel entropy for a ULID_KERNEL generator. It's kept apart
+ * from the generator so that the copy in a child process can be wiped
+ * at fork(), whether or not the child ever uses the generator.
+ */
+struct ulid_pool {
+    int avail;
+#if !defined(_WIN32) && !defined(__linux__)
+    struct ulid_pool *prev, *next;
+#endif
+    unsigned char buf[POOL_SIZE];
+};
+
+#if !defined(_WIN32) && !defined(__linux__)
+/* Without MADV_WIPEONFORK, every live pool is tracked so that the child
+ * side of pthread_atfork() can wipe them all.
+ */
+static struct ulid_pool *pools;
+static pthread_mutex_t pools_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t pools_once = PTHREAD_ONCE_INIT;
+
+static void
+pools_prepare(void)
+{
+    pthread_mutex_lock(&pools_lock);
+}
+
+static void
+pools_parent(void)
+{
+    pthread_mutex_unlock(&pools_lock);
+}
+
+static void
+pools_child(void)
+{
+    for (struct ulid_pool *p = pools; p; p = p->next) {
+        memset(p->buf, 0, sizeof(p->buf));
+        p->avail = 0;
+    }
+    pthread_mutex_unlock(&pools_lock);
+}
+
+static void
+pools_register(void)
+{
+    pthread_atfork(pools_prepare, pools_parent, pools_child);
+}
+#endif
+
+/* Allocate an empty entropy pool. Returns null on failure.
+ */
+static struct ulid_pool *
+pool_alloc(void)
+{
+#ifdef _WIN32
+    return calloc(1, sizeof(struct ulid_pool));
+#elif __linux__
+    /* The kernel zeroes this mapping in the child, avail included. */
+    void *p = mmap(0, sizeof(struct ulid_pool), PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return 0;
+    if (madvise(p, sizeof(struct ulid_pool), MADV_WIPEONFORK)) {
+        munmap(p, sizeof(struct ulid_pool));
+        return 0;
+    }
+    return p;
+#else
+    pthread_once(&pools_once, pools_register);
+    struct ulid_pool *p = calloc(1, sizeof(*p));
+    if (p) {
+        pthread_mutex_lock(&pools_lock);
+        p->next = pools;
+        if (pools)
+            pools->prev = p;
+        pools = p;
+        pthread_mutex_unlock(&pools_lock);
+    }
+    return p;
+#endif
+}
+
+static void
+pool_free(struct ulid_pool *p)
+{
+    if (!p)
+        return;
+#ifdef _WIN32
+    free(p);
+#elif __linux__
+    munmap(p, sizeof(*p));
+#else
+    pthread_mutex_lock(&pools_lock);
+    if (p->prev)
+        p->prev->next = p->next;
+    else
+        pools = p->next;
+    if (p->next)
+        p->next->prev = p->prev;
+    pthread_mutex_unlock(&pools_lock);
+    free(p);
+#endif
+}
+
+static void
+generator_reset(struct ulid_generator *g, int flags)
 {
     g->last_ts = 0;
     g->flags = flags;
     g->i = g->j = 0;
     for (int i = 0; i < 256; i++)
         g->s[i] = i;
+    g->pool = flags & ULID_KERNEL ? pool_alloc() : 0;
+}
+
+/* Mix a key into the RC4 state (key schedule).
+ */
+static void
+generator_mix(struct ulid_generator *g, const unsigned char *key, int len)
+{
+    for (int i = 0, j = 0; i < 256; i++) {
+        j = (j + g->s[i] + key[i % len]) & 0xff;
+        int tmp = g->s[i];
+        g->s[i] = g->s[j];
+        g->s[j] = tmp;
+    }
+}
+
+int
+ulid_generator_init(struct ulid_generator *g, int flags)
+{
+    generator_reset(g, flags);
 
     /* RC4 is used to fill the random segment of ULIDs. It's tiny,
      * simple, perfectly sufficient for the task (assuming it's seeded
@@ -92,12 +246,7 @@ ulid_generator_init(struct ulid_generator *g, int flags)
     unsigned char key[256] = {0};
     if (!platform_entropy(key, 256)) {
         /* Mix entropy into the RC4 state. */
-        for (int i = 0, j = 0; i < 256; i++) {
-            j = (j + g->s[i] + key[i]) & 0xff;
-            int tmp = g->s[i];
-            g->s[i] = g->s[j];
-            g->s[j] = tmp;
-        }
+        generator_mix(g, key, 256);
         initstyle = 0;
     } else if (!(flags & ULID_SECURE)) {
         /* Failed to read entropy from OS, so generate some. */
@@ -115,18 +264,58 @@ ulid_generator_init(struct ulid_generator *g, int flags)
             noise.clk = clock();
             noise.stackgap = &noise;
             noise.n = n;
-            unsigned char *k = (unsigned char *)&noise;
-            for (int i = 0, j = 0; i < 256; i++) {
-                j = (j + g->s[i] + k[i % sizeof(noise)]) & 0xff;
-                int tmp = g->s[i];
-                g->s[i] = g->s[j];
-                g->s[j] = tmp;
-            }
+            generator_mix(g, (unsigned char *)&noise, sizeof(noise));
         } while (n++ < 1UL << 16 || now - start < 500000ULL);
     }
+    if ((flags & ULID_KERNEL) && ulid_generator_refill(g))
+        initstyle = 1;
     return initstyle;
 }
 
+int
+ulid_generator_refill(struct ulid_generator *g)
+{
+    struct ulid_pool *p = g->pool;
+    if (!p)
+        return 1;
+    int len = sizeof(p->buf) - p->avail;
+    if (len && platform_entropy(p->buf + p->avail, len))
+        return 1;
+    p->avail = sizeof(p->buf);
+    return 0;
+}
+
+/* Take 10 bytes of buffered kernel entropy, refilling as needed.
+ * Returns non-zero, leaving dst untouched, if entropy is unavailable.
+ */
+static int
+generator_take(struct ulid_generator *g, unsigned char *dst)
+{
+    struct ulid_pool *p = g->pool;
+    if (!p || (p->avail < 10 && ulid_generator_refill(g)))
+        return 1;
+    p->avail -= 10;
+    memcpy(dst, p->buf + p->avail, 10);
+    memset(p->buf + p->avail, 0, 10);
+    return 0;
+}
+
+void
+ulid_generator_free(struct ulid_generator *g)
+{
+    pool_free(g->pool);
+    g->pool = 0;
+}
+
+void
+ulid_generator_seed(struct ulid_generator *g, int flags,
+                    const void *seed, int len)
+{
+    generator_reset(g, flags);
+    if (len > 0)
+        generator_mix(g, seed, len);
+}
+
 void
 ulid_encode(char str[27], const unsigned char ulid[16])
 {
@@ -254,20 +443,319 @@ ulid_decode(unsigned char ulid[16], const char *s)
     return 0;
 }
 
+long
+ulid_scan(unsigned char ulid[16], const char *buf, long len)
+{
+    /* Word characters: [0-9A-Za-z_] */
+    static const unsigned char word[256] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+        0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1,
+        0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+    /* Rather than examine every byte, jump to where a ULID after the
+     * last known word boundary would have to end, then look backwards
+     * for a non-word character. Short words are skipped without looking
+     * at most of their bytes, and nothing is examined twice.
+     */
+    const unsigned char *p = (const unsigned char *)buf;
+    long b = -1;  /* a word boundary: -1, len, or a non-word character */
+    long w = 0;   /* [b+1, w) are known to be word characters */
+    for (;;) {
+        /* A ULID starting just after b must end just before q */
+        long q = b + 27;
+        if (q > len)
+            return -1;
+
+        /* Find the last non-word character before q, if any */
+        long k = q;
+        while (--k >= w && word[p[k]]);
+        if (k >= w) {
+            b = k;
+            w = q;
+            continue;
+        }
+
+        if (q == len || !word[p[q]]) {
+            if (!ulid_decode(ulid, buf + b + 1))
+                return b + 1;
+            b = q;
+            w = q + 1;
+            continue;
+        }
+
+        /* The word is too long, so skip to its end */
+        for (k = q + 1; k < len && word[p[k]]; k++);
+        b = k;
+        w = k + 1;
+    }
+}
+
+/* Load 8 bytes as a big endian integer.
+ */
+static unsigned long long
+load64(const unsigned char *p)
+{
+    return (unsigned long long)p[0] << 56 |
+           (unsigned long long)p[1] << 48 |
+           (unsigned long long)p[2] << 40 |
+           (unsigned long long)p[3] << 32 |
+           (unsigned long long)p[4] << 24 |
+           (unsigned long long)p[5] << 16 |
+           (unsigned long long)p[6] <<  8 |
+           (unsigned long long)p[7] <<  0;
+}
+
+int
+ulid_compare(const unsigned char a[16], const unsigned char b[16])
+{
+    unsigned long long a0 = load64(a), a1 = load64(a + 8);
+    unsigned long long b0 = load64(b), b1 = load64(b + 8);
+    int c0 = (a0 > b0) - (a0 < b0);
+    int c1 = (a1 > b1) - (a1 < b1);
+    return c0 ? c0 : c1;
+}
+
+int
+ulid_add(unsigned char r[16], const unsigned char a[16],
+         const unsigned char b[16])
+{
+    unsigned carry = 0;
+    for (int i = 15; i >= 0; i--) {
+        unsigned sum = a[i] + b[i] + carry;
+        r[i] = sum;
+        carry = sum >> 8;
+    }
+    return carry;
+}
+
+int
+ulid_sub(unsigned char r[16], const unsigned char a[16],
+         const unsigned char b[16])
+{
+    unsigned borrow = 0;
+    for (int i = 15; i >= 0; i--) {
+        unsigned diff = 0x100 + a[i] - b[i] - borrow;
+        r[i] = diff;
+        borrow = 1 - (diff >> 8);
+    }
+    return borrow;
+}
+
+void
+ulid_distance(unsigned char r[16], const unsigned char a[16],
+              const unsigned char b[16])
+{
+    /* Compute both differences and select one with the borrow out of
+     * a - b, so the timing doesn't depend on which input is larger.
+     */
+    unsigned char ab[16], ba[16];
+    unsigned mask = -ulid_sub(ab, a, b) & 0xff;
+    ulid_sub(ba, b, a);
+    for (int i = 0; i < 16; i++)
+        r[i] = (ab[i] & ~mask) | (ba[i] & mask);
+}
+
+void
+ulid_min(unsigned char ulid[16], unsigned long long ts)
+{
+    for (int i = 0; i < 6; i++)
+        ulid[i] = ts >> (40 - i * 8);
+    memset(ulid + 6, 0x00, 10);
+}
+
 void
+ulid_max(unsigned char ulid[16], unsigned long long ts)
+{
+    for (int i = 0; i < 6; i++)
+        ulid[i] = ts >> (40 - i * 8);
+    memset(ulid + 6, 0xff, 10);
+}
+
+/* Store a small integer as a 128-bit big endian integer.
+ */
+static void
+store_small(unsigned char r[16], unsigned long long v)
+{
+    for (int i = 15; i >= 0; i--) {
+        r[i] = v;
+        v >>= 8;
+    }
+}
+
+void
+ulid_split(unsigned char (*bounds)[16], const unsigned char lo[16],
+           const unsigned char hi[16], int n)
+{
+    /* Boundary i is lo + floor(d * i / n), where d = hi - lo. To avoid
+     * 128-bit overflow this is computed as lo + q*i + floor(r*i / n),
+     * where q and r are the quotient and remainder of d / n.
+     */
+    unsigned char first[16], last[16], d[16], q[16];
+    memcpy(first, lo, 16);
+    memcpy(last, hi, 16);
+    ulid_sub(d, last, first);
+    unsigned long long rem = 0;
+    for (int i = 0; i < 16; i++) {
+        rem = rem << 8 | d[i];
+        q[i] = rem / n;
+        rem %= n;
+    }
+
+    for (int k = 0; k < n; k++) {
+        unsigned char t[16];
+        unsigned long long carry = 0;
+        for (int i = 15; i >= 0; i--) {
+            carry += (unsigned long long)q[i] * k;
+            t[i] = carry;
+            carry >>= 8;
+        }
+        ulid_add(t, t, first);
+        unsigned char f[16];
+        store_small(f, rem * k / n);
+        ulid_add(bounds[k], t, f);
+    }
+    memcpy(bounds[n], last, 16);
+}
+
+void
+ulid_split_time(unsigned char (*bounds)[16], const unsigned char lo[16],
+                const unsigned char hi[16], int n)
+{
+    unsigned long long t0 = load64(lo) >> 16;
+    unsigned long long t1 = load64(hi) >> 16;
+    unsigned long long d = t1 - t0;
+    unsigned long long q = d / n;
+    unsigned long long r = d % n;
+
+    unsigned char first[16], last[16];
+    memcpy(first, lo, 16);
+    memcpy(last, hi, 16);
+    for (int k = 1; k < n; k++) {
+        ulid_min(bounds[k], t0 + q * k + r * k / n);
+        if (ulid_compare(bounds[k], first) < 0)
+            memcpy(bounds[k], first, 16);
+    }
+    memcpy(bounds[0], first, 16);
+    memcpy(bounds[n], last, 16);
+}
+
+/* Returns non-zero if the head of run a sorts before the head of run b.
+ * Empty runs sort after everything, and ties go to the lower index so
+ * that merging is stable.
+ */
+static int
+merge_beats(const unsigned char **runs, const long *lens, int a, int b)
+{
+    if (!lens[a] || !lens[b])
+        return lens[a] && !lens[b];
+    int c = ulid_compare(runs[a], runs[b]);
+    return c ? c < 0 : a < b;
+}
+
+long
+ulid_merge(unsigned char *dst, long n,
+           const unsigned char **runs, long *lens, int k, int *tree)
+{
+    /* Loser tree: leaf i hangs below node (i + k) / 2, each internal
+     * node holds the loser of the match played there, and tree[0]
+     * holds the overall winner. Replacing the winner replays only the
+     * matches on its path to the root, so each ULID costs about log2(k)
+     * comparisons.
+     */
+    if (k < 1)
+        return 0;
+    for (int i = 0; i < k; i++)
+        tree[i] = -1;
+    for (int i = 0; i < k; i++) {
+        int w = i;
+        for (int t = (i + k) / 2; t > 0; t /= 2) {
+            if (tree[t] < 0) {
+                tree[t] = w;
+                w = -1;
+                break;
+            }
+            if (merge_beats(runs, lens, tree[t], w)) {
+                int tmp = tree[t];
+                tree[t] = w;
+                w = tmp;
+            }
+        }
+        if (w >= 0)
+            tree[0] = w;
+    }
+
+    long count = 0;
+    while (count < n) {
+        int w = tree[0];
+        if (!lens[w])
+            break;  /* all runs are empty */
+        memcpy(dst + count++ * 16, runs[w], 16);
+        runs[w] += 16;
+        if (!--lens[w])
+            break;  /* give the caller a chance to refill */
+        for (int t = (w + k) / 2; t > 0; t /= 2) {
+            if (merge_beats(runs, lens, tree[t], w)) {
+                int tmp = tree[t];
+                tree[t] = w;
+                w = tmp;
+            }
+        }
+        tree[0] = w;
+    }
+    return count;
+}
+
+int
 ulid_generate(struct ulid_generator *g, char str[27])
 {
-    unsigned long long ts = platform_utime(1) / 1000;
+    return ulid_generate_at(g, str, platform_utime(1) / 1000);
+}
 
+/* Advance the generator's last ULID to the next ULID at timestamp ts.
+ * Returns non-zero, leaving the generator unchanged, if kernel entropy
+ * could not be read.
+ */
+static int
+generator_next(struct ulid_generator *g, unsigned long long ts)
+{
     if (!(g->flags & ULID_RELAXED) && g->last_ts == ts) {
         /* Chance of 80-bit overflow is so small that it's not considered. */
         for (int i = 15; i > 5; i--)
             if (++g->last[i])
                 break;
-        ulid_encode(str, g->last);
-        return;
+        return 0;
     }
 
+    /* Fill out random section, never falling back from kernel entropy */
+    if (g->flags & ULID_KERNEL) {
+        if (generator_take(g, g->last + 6))
+            return 1;
+    } else {
+        for (int k = 0; k < 10; k++) {
+            g->i = (g->i + 1) & 0xff;
+            g->j = (g->j + g->s[g->i]) & 0xff;
+            int tmp = g->s[g->i];
+            g->s[g->i] = g->s[g->j];
+            g->s[g->j] = tmp;
+            g->last[6 + k] = g->s[(g->s[g->i] + g->s[g->j]) & 0xff];
+        }
+    }
+    if (g->flags & ULID_PARANOID)
+        g->last[6] &= 0x7f;
+
     /* Fill out timestamp */
     g->last_ts = ts;
     g->last[0] = ts >> 40;
@@ -276,18 +764,339 @@ ulid_generate(struct ulid_generator *g, char str[27])
     g->last[3] = ts >> 16;
     g->last[4] = ts >>  8;
     g->last[5] = ts >>  0;
+    return 0;
+}
 
-    /* Fill out random section */
-    for (int k = 0; k < 10; k++) {
-        g->i = (g->i + 1) & 0xff;
-        g->j = (g->j + g->s[g->i]) & 0xff;
-        int tmp = g->s[g->i];
-        g->s[g->i] = g->s[g->j];
-        g->s[g->j] = tmp;
-        g->last[6 + k] = g->s[(g->s[g->i] + g->s[g->j]) & 0xff];
+int
+ulid_generate_at(struct ulid_generator *g, char str[27], unsigned long long ts)
+{
+    if (generator_next(g, ts)) {
+        str[0] = 0;
+        return 1;
     }
-    if (g->flags & ULID_PARANOID)
-        g->last[6] &= 0x7f;
-
     ulid_encode(str, g->last);
+    return 0;
+}
+
+void
+ulid_generator_lease(struct ulid_generator *g, struct ulid_lease *lease,
+                     unsigned long n)
+{
+    lease->count = n;
+    if (!n)
+        return;
+    if (generator_next(g, platform_utime(1) / 1000)) {
+        lease->count = 0;
+        return;
+    }
+    memcpy(lease->next, g->last, 16);
+
+    /* Skip the generator past the rest of the lease. */
+    unsigned long long carry = n - 1;
+    for (int i = 15; i > 5 && carry; i--) {
+        carry += g->last[i];
+        g->last[i] = carry;
+        carry >>= 8;
+    }
+}
+
+int
+ulid_lease_generate(struct ulid_lease *lease, char str[27])
+{
+    if (!lease->count)
+        return 1;
+    ulid_encode(str, lease->next);
+    for (int i = 15; i > 5; i--)
+        if (++lease->next[i])
+            break;
+    lease->count--;
+    return 0;
+}
+
+#ifndef _WIN32
+/* A peer that disconnects must not raise SIGPIPE, which would kill the
+ * daemon or a client. Where send() can't suppress it per call, each
+ * socket is marked with SO_NOSIGPIPE instead.
+ */
+#ifndef MSG_NOSIGNAL
+#  ifndef SO_NOSIGPIPE
+#    error "no way to suppress SIGPIPE on sockets"
+#  endif
+#  define MSG_NOSIGNAL 0
+#endif
+
+/* Returns non-zero if the socket could not be configured.
+ */
+static int
+lease_nosigpipe(int fd)
+{
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    return setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#else
+    (void)fd;
+    return 0;
+#endif
+}
+
+/* Write exactly len bytes to a socket. Returns 0 on success.
+ */
+static int
+full_write(int fd, const unsigned char *buf, long len)
+{
+    while (len > 0) {
+        long r = send(fd, buf, len, MSG_NOSIGNAL);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return 1;
+        buf += r;
+        len -= r;
+    }
+    return 0;
 }
+
+/* Read exactly len bytes. Returns 0 on success.
+ */
+static int
+full_read(int fd, unsigned char *buf, long len)
+{
+    while (len > 0) {
+        long r = read(fd, buf, len);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return 1;
+        buf += r;
+        len -= r;
+    }
+    return 0;
+}
+
+/* Per-client buffers for the lease daemon, so that no client can block
+ * it with a partial request or by not reading its responses.
+ */
+#define LEASE_BATCH 64  /* requests answered per read and write */
+
+struct lease_client {
+    int reqlen;           /* bytes of buffered requests */
+    int resplen, respoff; /* bytes of pending responses and bytes sent */
+    unsigned char req[LEASE_BATCH * 4];
+    unsigned char resp[LEASE_BATCH * 20];
+};
+
+/* Send as much of a client's pending response as the socket accepts.
+ * Returns -1 if the client should be dropped.
+ */
+static int
+lease_flush(struct lease_client *c, int fd)
+{
+    while (c->respoff < c->resplen) {
+        long r = send(fd, c->resp + c->respoff, c->resplen - c->respoff,
+                      MSG_NOSIGNAL);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        if (r <= 0)
+            return -1;
+        c->respoff += r;
+    }
+    c->resplen = c->respoff = 0;
+    return 0;
+}
+
+/* Read whatever requests are waiting on a client's socket and answer
+ * every complete request in one batch. Returns -1 if the client should
+ * be dropped.
+ */
+static int
+lease_serve(struct ulid_generator *g, struct lease_client *c, int fd)
+{
+    /* Requests are a 4-byte big endian ULID count. Responses are the
+     * first ULID of the lease in binary followed by its 4-byte count,
+     * which is zero if the generator couldn't produce the lease.
+     */
+    long len;
+    do
+        len = read(fd, c->req + c->reqlen, sizeof(c->req) - c->reqlen);
+    while (len < 0 && errno == EINTR);
+    if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
+    if (len <= 0)
+        return -1;
+    c->reqlen += len;
+
+    int nreq = c->reqlen / 4;
+    for (int i = 0; i < nreq; i++) {
+        const unsigned char *q = c->req + i * 4;
+        unsigned char *p = c->resp + i * 20;
+        struct ulid_lease lease = {{0}, 0};
+        ulid_generator_lease(g, &lease,
+                             (unsigned long)q[0] << 24 | q[1] << 16 |
+                                            q[2] <<  8 | q[3] <<  0);
+        memcpy(p, lease.next, 16);
+        p[16] = lease.count >> 24;
+        p[17] = lease.count >> 16;
+        p[18] = lease.count >>  8;
+        p[19] = lease.count >>  0;
+    }
+    c->reqlen -= nreq * 4;
+    memmove(c->req, c->req + nreq * 4, c->reqlen);
+    c->resplen = nreq * 20;
+    c->respoff = 0;
+    return lease_flush(c, fd);
+}
+
+/* Fill out a Unix domain socket address. Returns non-zero on failure.
+ */
+static int
+lease_addr(struct sockaddr_un *addr, const char *path)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path))
+        return 1;
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+int
+ulid_lease_daemon(struct ulid_generator *g, const char *path)
+{
+    struct sockaddr_un addr;
+    if (lease_addr(&addr, path))
+        return -1;
+
+    /* Only replace a stale socket, never some other file. */
+    struct stat st;
+    if (!lstat(path, &st) && S_ISSOCK(st.st_mode))
+        unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1)
+        return -1;
+    if (lease_nosigpipe(fd) ||
+        bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 64)) {
+        close(fd);
+        return -1;
+    }
+
+    /* Clients are served from a fixed table, so connections beyond its
+     * capacity wait in the listen backlog until a slot frees up. Client
+     * sockets are non-blocking, and a client with a pending response
+     * isn't read again until the response has been sent.
+     */
+    struct pollfd fds[256];
+    struct lease_client *clients = malloc(sizeof(*clients) * 256);
+    if (!clients) {
+        close(fd);
+        return -1;
+    }
+    int nfds = 1;
+    fds[0].fd = fd;
+    fds[0].events = POLLIN;
+    for (;;) {
+        fds[0].events = nfds < 256 ? POLLIN : 0;
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int i = 1; i < nfds; i++) {
+            struct lease_client *c = clients + i;
+            int r = 0;
+            if (fds[i].revents & POLLNVAL)
+                r = -1;
+            else if (fds[i].revents && c->resplen)
+                r = lease_flush(c, fds[i].fd);
+            else if (fds[i].revents)
+                r = lease_serve(g, c, fds[i].fd);
+            if (r < 0) {
+                close(fds[i].fd);
+                fds[i] = fds[--nfds];
+                clients[i--] = clients[nfds];
+            } else {
+                fds[i].events = c->resplen ? POLLOUT : POLLIN;
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int c = accept(fd, 0, 0);
+            if (c != -1 && (fcntl(c, F_SETFL, O_NONBLOCK) ||
+                            lease_nosigpipe(c))) {
+                close(c);
+            } else if (c != -1) {
+                fds[nfds].fd = c;
+                fds[nfds].events = POLLIN;
+                fds[nfds].revents = 0;
+                clients[nfds].reqlen = 0;
+                clients[nfds].resplen = clients[nfds].respoff = 0;
+                nfds++;
+            }
+        }
+    }
+
+    for (int i = 0; i < nfds; i++)
+        close(fds[i].fd);
+    free(clients);
+    return -1;
+}
+
+int
+ulid_lease_connect(const char *path)
+{
+    struct sockaddr_un addr;
+    if (lease_addr(&addr, path))
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd != -1 && (lease_nosigpipe(fd) ||
+                     connect(fd, (struct sockaddr *)&addr, sizeof(addr)))) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+int
+ulid_lease_request_n(int fd, struct ulid_lease *leases,
+                     const unsigned long *counts, int k)
+{
+    /* Send requests in the daemon's batch size, so that each batch is
+     * answered with one write while the next is not yet sent.
+     */
+    while (k > 0) {
+        int m = k < LEASE_BATCH ? k : LEASE_BATCH;
+        unsigned char req[LEASE_BATCH * 4];
+        unsigned char resp[LEASE_BATCH * 20];
+        for (int i = 0; i < m; i++) {
+            unsigned long n = counts[i];
+            if (n > 0xffffffffUL)
+                n = 0xffffffffUL;
+            req[i * 4 + 0] = n >> 24;
+            req[i * 4 + 1] = n >> 16;
+            req[i * 4 + 2] = n >>  8;
+            req[i * 4 + 3] = n >>  0;
+        }
+        if (full_write(fd, req, m * 4) || full_read(fd, resp, m * 20))
+            return 1;
+        for (int i = 0; i < m; i++) {
+            const unsigned char *p = resp + i * 20;
+            memcpy(leases[i].next, p, 16);
+            leases[i].count = (unsigned long)p[16] << 24 | p[17] << 16 |
+                                             p[18] <<  8 | p[19] <<  0;
+        }
+        leases += m;
+        counts += m;
+        k -= m;
+    }
+    return 0;
+}
+
+int
+ulid_lease_request(int fd, struct ulid_lease *lease, unsigned long n)
+{
+    return ulid_lease_request_n(fd, lease, &n, 1);
+}
+#endif
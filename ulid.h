@@ -5,10 +5,17 @@
 #ifndef ULID_H
 #define ULID_H
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* Generator configuration flags */
 #define ULID_RELAXED   (1 << 0)
 #define ULID_PARANOID  (1 << 1)
 #define ULID_SECURE    (1 << 2)
+#define ULID_KERNEL    (1 << 3)
+
+struct ulid_pool;
 
 struct ulid_generator {
     unsigned char last[16];
@@ -16,6 +23,13 @@ struct ulid_generator {
     int flags;
     unsigned char i, j;
     unsigned char s[256];
+    struct ulid_pool *pool;
+};
+
+/* A contiguous range of ULIDs reserved from a generator. */
+struct ulid_lease {
+    unsigned char next[16];
+    unsigned long count;
 };
 
 /* Initialize a new ULID generator instance.
@@ -34,16 +48,117 @@ struct ulid_generator {
  * system entropy could not be gathered. You _must_ check the return
  * value if you use this flag, since it now indicates a hard error.
  *
+ * The ULID_KERNEL flag takes the random field of each fresh ULID
+ * directly from operating system entropy instead of the userspace RC4
+ * generator. Entropy is read in large batches into a buffer allocated
+ * for the generator, 10 bytes are drained per ULID, and each byte is
+ * zeroed as it's used. The buffer is wiped in the child process at
+ * fork(), so parent and child never share bytes (Linux 4.14 and later:
+ * MADV_WIPEONFORK; other POSIX: pthread_atfork()). RC4 is never used
+ * for the random field in this mode: if entropy can't be read, no ULID
+ * is generated and ulid_generate() returns non-zero. Release the
+ * buffer with ulid_generator_free().
+ *
  * Returns 0 if the generator was successfully initialized from secure
  * system entropy. Returns 1 if this failed and instead derived entropy
  * in userspace (or is uninitialized in the case of ULID_SECURE).
  */
 int  ulid_generator_init(struct ulid_generator *, int flags);
 
+/* Top up a ULID_KERNEL generator's entropy buffer now.
+ *
+ * Buffers are otherwise refilled on demand when empty, so call this
+ * ahead of time, e.g. while otherwise idle, to keep refills off the
+ * critical path. Returns non-zero if entropy could not be read.
+ */
+int  ulid_generator_refill(struct ulid_generator *);
+
+/* Release the resources held by a generator, i.e. a ULID_KERNEL entropy
+ * buffer. Call this before discarding or reinitializing a generator
+ * initialized with ULID_KERNEL. It does nothing for other generators.
+ * A ULID_KERNEL generator has no entropy afterwards, so generating fails.
+ */
+void ulid_generator_free(struct ulid_generator *);
+
+/* Initialize a ULID generator from a caller-supplied seed.
+ *
+ * Unlike ulid_generator_init(), no system entropy is gathered, so the
+ * generator produces the same random bits for the same seed and flags.
+ * This is intended for reproducible tests and synthetic workloads, and
+ * must not be used where ULIDs need to be unpredictable. With
+ * ULID_KERNEL, the random fields still come from the kernel.
+ */
+void ulid_generator_seed(struct ulid_generator *, int flags,
+                         const void *seed, int len);
+
 /* Generate a new ULID.
- * A zero terminating byte is written to the output buffer.
+ * A zero terminating byte is written to the output buffer. Returns
+ * non-zero, writing an empty string, only if a ULID_KERNEL generator
+ * could not read entropy. The generator is unchanged, so it's safe to
+ * try again later.
+ */
+int  ulid_generate(struct ulid_generator *, char [27]);
+
+/* Generate a new ULID with the given unix epoch millisecond timestamp.
+ * This is ulid_generate() with the clock supplied by the caller. ULIDs
+ * are only monotonic among consecutive calls with the same timestamp.
+ * A zero terminating byte is written to the output buffer. Returns
+ * non-zero like ulid_generate().
+ */
+int  ulid_generate_at(struct ulid_generator *, char [27],
+                      unsigned long long);
+
+/* Reserve the next n consecutive ULIDs from a generator as a lease.
+ *
+ * The lease can then be drained with ulid_lease_generate() without
+ * further access to the generator, such as in another process. All
+ * ULIDs in the lease share the timestamp at which it was reserved, and
+ * they sort after every ULID the generator produced before the lease
+ * and before every ULID it produces after (unless ULID_RELAXED). Keep
+ * leases small enough that they are used up within a millisecond or so.
+ * If a ULID_KERNEL generator could not read entropy, the lease is empty.
+ */
+void ulid_generator_lease(struct ulid_generator *, struct ulid_lease *,
+                          unsigned long n);
+
+/* Issue the next ULID from a lease.
+ * A zero terminating byte is written to the output buffer. Returns
+ * non-zero, writing nothing, if the lease is used up.
+ */
+int  ulid_lease_generate(struct ulid_lease *, char [27]);
+
+#ifndef _WIN32
+/* Serve leases from a generator on a Unix domain socket (POSIX only).
+ *
+ * A stale socket at the path is replaced, but any other existing file
+ * is an error. Requests from each client are answered in batches, with
+ * one read and one write for all the requests waiting on that client.
+ * Clients are served without blocking, so a client that stalls or
+ * stops reading can't hold up the others, and clients are dropped on
+ * error. Only returns on error, returning -1.
+ */
+int  ulid_lease_daemon(struct ulid_generator *, const char *path);
+
+/* Connect to a ulid_lease_daemon() socket (POSIX only).
+ * Returns a socket file descriptor, or -1 on error.
+ */
+int  ulid_lease_connect(const char *path);
+
+/* Request a lease of n ULIDs over a connected socket (POSIX only).
+ * Each request is one round trip. Returns non-zero on error. The lease
+ * is empty if the daemon's generator could not produce it, so check
+ * its count.
  */
-void ulid_generate(struct ulid_generator *, char [27]);
+int  ulid_lease_request(int fd, struct ulid_lease *, unsigned long n);
+
+/* Request k leases at once, of counts[i] ULIDs each (POSIX only).
+ * The requests are pipelined so the daemon answers up to 64 of them
+ * with one read and one write, in one round trip per 64 requests.
+ * Returns non-zero on error.
+ */
+int  ulid_lease_request_n(int fd, struct ulid_lease *,
+                          const unsigned long *counts, int k);
+#endif
 
 /* Encode a 128-bit binary ULID to its text format.
  * A zero terminating byte is written to the output buffer.
@@ -55,4 +170,78 @@ void ulid_encode(char [27], const unsigned char [16]);
  */
 int  ulid_decode(unsigned char [16], const char *);
 
+/* Find the first ULID embedded in a buffer of arbitrary text.
+ * A ULID is a run of exactly 26 Base32 characters on word boundaries
+ * (e.g. not adjacent to [0-9A-Za-z_]) that ulid_decode() accepts. The
+ * buffer need not be null terminated, and the ends of the buffer are
+ * treated as word boundaries.
+ *
+ * Returns the offset of the ULID within the buffer, having decoded it
+ * into the 128-bit output, or -1 if the buffer contains no ULID. To
+ * find every ULID, call again just past each match.
+ */
+long ulid_scan(unsigned char [16], const char *, long);
+
+/* Merge sorted runs of binary ULIDs into one sorted sequence.
+ *
+ * Each of the k runs is an array of 16-byte binary ULIDs with the
+ * number of ULIDs in lens. As ULIDs are consumed, runs and lens are
+ * advanced in place. The tree array is k ints of scratch space. Equal
+ * ULIDs are output in run order.
+ *
+ * Merging stops when the output holds the requested number of ULIDs,
+ * or as soon as any run becomes empty. Runs that are empty on entry are
+ * considered finished. To merge streams in bounded memory, refill every
+ * empty run that has more input, then call again.
+ *
+ * Returns the number of ULIDs written to the output, which is zero
+ * only once all runs are finished (or if no output was requested). With
+ * k == 0 there's nothing to merge and zero is returned.
+ */
+long ulid_merge(unsigned char *, long,
+                const unsigned char **runs, long *lens, int k, int *tree);
+
+/* Compare two binary ULIDs as 128-bit unsigned integers.
+ * Returns negative, zero, or positive like memcmp().
+ */
+int  ulid_compare(const unsigned char [16], const unsigned char [16]);
+
+/* 128-bit unsigned arithmetic on binary ULIDs: r = a + b, r = a - b,
+ * and r = |a - b|. The output may alias either input. ulid_add()
+ * returns the carry out and ulid_sub() returns the borrow out.
+ */
+int  ulid_add(unsigned char r[16], const unsigned char a[16],
+              const unsigned char b[16]);
+int  ulid_sub(unsigned char r[16], const unsigned char a[16],
+              const unsigned char b[16]);
+void ulid_distance(unsigned char r[16], const unsigned char a[16],
+                   const unsigned char b[16]);
+
+/* The smallest and largest binary ULIDs with the given unix epoch
+ * millisecond timestamp.
+ */
+void ulid_min(unsigned char [16], unsigned long long);
+void ulid_max(unsigned char [16], unsigned long long);
+
+/* Split the range [lo, hi) into n contiguous sub-ranges.
+ *
+ * Writes n + 1 boundaries, where sub-range i is [bounds[i], bounds[i+1]),
+ * bounds[0] is lo, and bounds[n] is hi. Requires lo <= hi and n > 0.
+ * The bounds array may alias lo or hi.
+ *
+ * ulid_split() makes the sub-ranges as equal in size as possible.
+ * ulid_split_time() instead splits the timestamps evenly and places
+ * every interior boundary on the first ULID of a millisecond, so no
+ * millisecond straddles two sub-ranges. Sub-ranges may then be empty
+ * if the range spans fewer than n milliseconds.
+ */
+void ulid_split(unsigned char (*bounds)[16], const unsigned char lo[16],
+                const unsigned char hi[16], int n);
+void ulid_split_time(unsigned char (*bounds)[16], const unsigned char lo[16],
+                     const unsigned char hi[16], int n);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
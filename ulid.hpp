@@ -0,0 +1,206 @@
+/* ULID generation and parsing library (C++ API)
+ *
+ * Requires C++14. Encoding and decoding are implemented inline and are
+ * constexpr, so constant ULIDs can be validated and converted at
+ * compile time:
+ *
+ *   using namespace ulid_literals;
+ *   constexpr ulid id = "01ARZ3NDEKTSV4RRFFQ69G5FAV"_ulid;
+ *
+ * This is free and unencumbered software released into the public domain.
+ */
+#ifndef ULID_HPP
+#define ULID_HPP
+
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include "ulid.h"
+
+/* A 128-bit binary ULID, byte-for-byte the same as the C API's
+ * unsigned char[16], so it may be passed to ulid_encode() and friends.
+ */
+struct ulid {
+    unsigned char bytes[16];
+
+    /* Decode a text ULID, as ulid_decode().
+     * Returns false, leaving the ULID unmodified, if input was invalid.
+     */
+    constexpr bool decode(const char *s) noexcept
+    {
+        unsigned long long hi = 0, lo = 0;
+        for (int i = 0; i < 26; i++) {
+            int v = digit(s[i]);
+            if (v < 0 || (i == 0 && v > 7))
+                return false;
+            hi = hi << 5 | lo >> 59;
+            lo = lo << 5 | v;
+        }
+        for (int i = 0; i < 8; i++) {
+            bytes[i + 0] = static_cast<unsigned char>(hi >> (56 - i * 8));
+            bytes[i + 8] = static_cast<unsigned char>(lo >> (56 - i * 8));
+        }
+        return true;
+    }
+
+    /* Encode to text format, as ulid_encode().
+     * A zero terminating byte is written to the output buffer.
+     */
+    constexpr void encode(char str[27]) const noexcept
+    {
+        const char *set = "0123456789ABCDEFGHJKMNPQRSTVWXYZ";
+        unsigned long long hi = high(), lo = low();
+        for (int i = 0; i < 26; i++) {
+            int s = 5 * (25 - i);
+            unsigned long long v = 0;
+            if (s >= 64)
+                v = hi >> (s - 64);
+            else if (s > 59)
+                v = lo >> s | hi << (64 - s);
+            else
+                v = lo >> s;
+            str[i] = set[v & 0x1f];
+        }
+        str[26] = 0;
+    }
+
+    /* Decode a text ULID, throwing std::invalid_argument if invalid.
+     * In a constant expression an invalid ULID is a compile error.
+     */
+    static constexpr ulid parse(const char *s)
+    {
+        ulid r{};
+        if (!r.decode(s))
+            throw std::invalid_argument("invalid ULID");
+        return r;
+    }
+
+    std::string str() const
+    {
+        char buf[27];
+        encode(buf);
+        return std::string(buf, 26);
+    }
+
+    /* Unix epoch millisecond timestamp. */
+    constexpr unsigned long long timestamp() const noexcept
+    {
+        return high() >> 16;
+    }
+
+    /* The ULID as a big endian 128-bit integer, in two halves. */
+    constexpr unsigned long long high() const noexcept
+    {
+        return load(0);
+    }
+
+    constexpr unsigned long long low() const noexcept
+    {
+        return load(8);
+    }
+
+    friend constexpr bool operator==(const ulid &a, const ulid &b) noexcept
+    {
+        return a.high() == b.high() && a.low() == b.low();
+    }
+
+    friend constexpr bool operator!=(const ulid &a, const ulid &b) noexcept
+    {
+        return !(a == b);
+    }
+
+    friend constexpr bool operator<(const ulid &a, const ulid &b) noexcept
+    {
+        return a.high() < b.high() ||
+              (a.high() == b.high() && a.low() < b.low());
+    }
+
+    friend constexpr bool operator>(const ulid &a, const ulid &b) noexcept
+    {
+        return b < a;
+    }
+
+    friend constexpr bool operator<=(const ulid &a, const ulid &b) noexcept
+    {
+        return !(b < a);
+    }
+
+    friend constexpr bool operator>=(const ulid &a, const ulid &b) noexcept
+    {
+        return !(a < b);
+    }
+
+private:
+    constexpr unsigned long long load(int off) const noexcept
+    {
+        unsigned long long r = 0;
+        for (int i = 0; i < 8; i++)
+            r = r << 8 | bytes[off + i];
+        return r;
+    }
+
+    static constexpr int digit(char c) noexcept
+    {
+        /* Base32 values of 'A' through 'Z' */
+        const signed char letters[26] = {
+            0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x01,
+            0x12, 0x13, 0x01, 0x14, 0x15, 0x00, 0x16, 0x17, 0x18,
+            0x19, 0x1a,   -1, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f
+        };
+        return c >= '0' && c <= '9' ? c - '0' :
+               c >= 'A' && c <= 'Z' ? letters[c - 'A'] :
+               c >= 'a' && c <= 'z' ? letters[c - 'a'] :
+               -1;
+    }
+};
+
+static_assert(sizeof(ulid) == 16, "ulid must be 16 bytes");
+static_assert(std::is_trivially_copyable<ulid>::value,
+              "ulid must be trivially copyable");
+
+/* Encode n ULIDs into consecutive 27-byte text slots.
+ */
+inline void
+ulid_encode_n(char (*dst)[27], const ulid *src, std::size_t n) noexcept
+{
+    for (std::size_t i = 0; i < n; i++)
+        src[i].encode(dst[i]);
+}
+
+/* Decode n text ULIDs from consecutive 27-byte text slots.
+ * Returns the number decoded, stopping at the first invalid ULID.
+ */
+inline std::size_t
+ulid_decode_n(ulid *dst, const char (*src)[27], std::size_t n) noexcept
+{
+    std::size_t i = 0;
+    for (; i < n; i++)
+        if (!dst[i].decode(src[i]))
+            break;
+    return i;
+}
+
+namespace ulid_literals {
+    /* "01ARZ3NDEKTSV4RRFFQ69G5FAV"_ulid */
+    constexpr ulid operator""_ulid(const char *s, std::size_t len)
+    {
+        if (len != 26)
+            throw std::invalid_argument("invalid ULID length");
+        return ulid::parse(s);
+    }
+}
+
+namespace std {
+    /* The low 64 bits are random, so they make a good hash as-is. */
+    template<>
+    struct hash<ulid> {
+        std::size_t operator()(const ulid &u) const noexcept
+        {
+            return static_cast<std::size_t>(u.low());
+        }
+    };
+}
+
+#endif